@@ -23,6 +23,24 @@
 #include <limits>
 #include <variant>
 #include <chrono>
+#include <string>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
+#include <atomic>
+
+#ifdef _WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#else
+#  include <cerrno>
+#  include <fcntl.h>
+#  include <sys/file.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
 
 constexpr float Inf = std::numeric_limits<float>::infinity();
 constexpr float Eps = 0.000001f;
@@ -125,31 +143,252 @@ struct Sphere {
 
 using Primitive = std::variant<Sphere>;
 
+// Per-pass values hoisted out of the specialized kernels
+struct KernelConstants {
+    glm::vec3 pos, X, Y, Z;
+    glm::vec3 lightDir;
+};
+
+// Read/write shared file mapping. Writes land in the page cache immediately,
+// so they survive the process being killed without any explicit save step
+struct MappedFile {
+    void* data = nullptr;
+    size_t size = 0;
+    bool inUse = false; // Last open failed because another process holds the file for writing
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        Close();
+    }
+
+    // Map an existing file at its current size. Writable files are locked exclusively
+    bool Open(const char* path, bool writable)
+    {
+        Close();
+        inUse = false;
+#ifdef _WIN32
+        file = CreateFileA(path, writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+            writable ? FILE_SHARE_READ : (FILE_SHARE_READ | FILE_SHARE_WRITE),
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            inUse = GetLastError() == ERROR_SHARING_VIOLATION;
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            return Close(), false;
+        size = size_t(fileSize.QuadPart);
+#else
+        fd = open(path, writable ? O_RDWR : O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        if (writable && flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            inUse = errno == EWOULDBLOCK;
+            return Close(), false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+            return Close(), false;
+        size = size_t(st.st_size);
+#endif
+        return Map(writable);
+    }
+
+    // Create, lock and map a new file of newSize bytes, failing if the file already exists.
+    // A file left behind by a failed create is removed again
+    bool Create(const char* path, size_t newSize)
+    {
+        Close();
+        inUse = false;
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+            CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER fileSize;
+        fileSize.QuadPart = LONGLONG(newSize);
+        size = newSize;
+        if (!SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN) || !SetEndOfFile(file) || !Map(true)) {
+            Close();
+            DeleteFileA(path);
+            return false;
+        }
+#else
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+            return false;
+
+        size = newSize;
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0 || ftruncate(fd, off_t(newSize)) != 0 || !Map(true)) {
+            Close();
+            unlink(path);
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    // Schedule dirty pages to be written back to disk. Not needed to survive the
+    // process being killed, only a system crash, so this is called periodically
+    void Flush()
+    {
+        if (!data) return;
+#ifdef _WIN32
+        FlushViewOfFile(data, 0);
+#else
+        msync(data, size, MS_ASYNC);
+#endif
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data) UnmapViewOfFile(data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (data) munmap(data, size);
+        if (fd >= 0) close(fd);
+        fd = -1;
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+private:
+    bool Map(bool writable)
+    {
+#ifdef _WIN32
+        mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return Close(), false;
+
+        data = MapViewOfFile(mapping, writable ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0);
+        if (!data)
+            return Close(), false;
+#else
+        data = mmap(nullptr, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            data = nullptr;
+            return Close(), false;
+        }
+#endif
+        return true;
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<std::mt19937_64>);
+
+// Accumulation state at the end of a completed pass
+struct CheckpointPass {
+    static constexpr uint32_t MaxRuns = 64;
+
+    int32_t sample;
+    uint64_t rays;
+    unsigned char rng[sizeof(std::mt19937_64)];
+    uint32_t runCount;
+    uint64_t runs[MaxRuns]; // Seeds of every run whose samples are in the accumulation
+};
+
+// Checkpoint file layout: header followed by two accumulation buffers.
+// Each pass reads from buffer [current] and writes to the other, then flips
+// current, so a killed process always leaves the last completed pass intact
+struct alignas(16) CheckpointHeader {
+    static constexpr uint32_t Magic = 0x50435452; // "RTCP"
+    static constexpr uint32_t Version = 3;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sceneHash;
+    uint64_t seed;
+    glm::ivec2 textureSize;
+    float fovDegrees;
+    float texSizeMultiplier;
+    float jitter;
+    uint32_t shadows;
+    uint32_t current;
+    CheckpointPass passes[2];
+
+    static size_t FileSize(glm::ivec2 size)
+    {
+        return sizeof(CheckpointHeader) + 2 * size_t(size.x) * size_t(size.y) * sizeof(glm::vec4);
+    }
+
+    glm::vec4* Buffer(uint32_t index)
+    {
+        return reinterpret_cast<glm::vec4*>(this + 1) + index * size_t(textureSize.x) * size_t(textureSize.y);
+    }
+};
+
 struct App {
     GLFWwindow *window;
     glm::ivec2 windowSize;
 
-    glm::ivec2 textureSize;
+    glm::ivec2 textureSize { 0, 0 };
     std::vector<glm::vec4> pixels;
 
+    // Accumulation buffers. Point into pixels, or into the checkpoint file when one is attached
+    glm::vec4* front = nullptr; // Last completed pass
+    glm::vec4* back = nullptr;  // Pass in progress
+
     GLuint texture;
     GLuint framebuffer;
 
     RNG rng;
+    uint64_t seed = 0;
 
     //// Custom Variables ////
 
     float texSizeMultiplier = 0.1;
 
     float fovDegrees = 90.f;
+    float jitterAmount = 1.f;
+    bool shadows = true;
+    bool specializedKernels = true;
+    float genericPassTime = 0.f;
+    float specializedPassTime = 0.f;
+    glm::ivec2 benchmarkSize { 0, 0 };
     int sample = 0;
     uint64_t rays = 0;
+    uint64_t sessionRaysStart = 0; // Rays traced before this session, from resumed or merged checkpoints
     std::chrono::high_resolution_clock::time_point sampleStart;
     std::chrono::high_resolution_clock::time_point sampleEnd;
 
+    // Progressive preview: after a change, trace blocks of previewBlock pixels and halve it each frame
+    int previewLevels = 3; // Coarsest preview is 1 / 2^previewLevels resolution
+    int previewFirstBlock = 0;
+    int previewBlock = 0;
+    std::chrono::high_resolution_clock::time_point changeTime;
+    float firstImageLatency = 0.f;
+    bool awaitingFirstImage = false;
+
     std::vector<Color> colours;
     std::vector<Primitive> primitives;
 
+    MappedFile checkpoint;
+    std::string checkpointPath;
+    std::vector<uint64_t> runs; // Seeds of every run whose samples are in the accumulation
+    std::chrono::steady_clock::time_point lastFlush;
+    std::string checkpointStatus;
+    char checkpointInput[256] = "render.rtcp";
+    char mergeInput[256] = "";
+
     //// End of Custom Variables ////
 
     App()
@@ -166,6 +405,10 @@ struct App {
         gladLoadGL(glfwGetProcAddress);
         glfwSwapInterval(1);
 
+        // Seed per run so that checkpoints from separate runs contain independent samples
+        seed = std::random_device{}();
+        rng.rng.seed(seed);
+
         // Register for resize callback
         glfwSetWindowUserPointer(window, this);
         glfwSetWindowSizeCallback(window, [](auto wnd, int w, int h) {
@@ -197,6 +440,8 @@ struct App {
 
     ~App()
     {
+        checkpoint.Flush();
+
         ImGui_ImplOpenGL3_Shutdown();
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
@@ -205,30 +450,39 @@ struct App {
         glfwTerminate();
     }
 
-    glm::vec4& Pixel(int x, int y)
+    glm::vec4& Pixel(glm::vec4* buffer, int x, int y)
     {
-        return pixels[y * textureSize.x + x];
+        return buffer[y * textureSize.x + x];
     }
 
     void WritePixelsToTexture()
     {
         glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, textureSize.x, textureSize.y, 0, GL_RGBA, GL_FLOAT, pixels.data());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, textureSize.x, textureSize.y, 0, GL_RGBA, GL_FLOAT, front);
     }
 
     void OnResize(int w, int h)
     {
         windowSize = { w, h };
 
-        ResizeTexture(int(w * texSizeMultiplier), int(h * texSizeMultiplier));
+        // Only a change in texture size invalidates the accumulation
+        // Minimised windows report a zero size, keep the current accumulation
+        glm::ivec2 size { int(w * texSizeMultiplier), int(h * texSizeMultiplier) };
+        if (size.x <= 0 || size.y <= 0)
+            return;
+
+        if (size != textureSize)
+            ResizeTexture(size.x, size.y);
     }
 
     void ResizeTexture(int w, int h)
     {
         // Resize CPU-side pixel storage
         // (OpenGL Resources are automatically resized on WritePixelsToTexture)
+        DetachCheckpoint();
         textureSize = { w, h };
         pixels.resize(textureSize.x * textureSize.y);
+        front = back = pixels.data();
 
         ResetSamples();
     }
@@ -266,42 +520,510 @@ struct App {
         auto lightDir = glm::normalize(glm::vec3(-2.f, 1.f, 1.f));
         float light = glm::dot(hit.normal, lightDir);
 
-        ray.origin = hit.point;
+        if (!shadows)
+            return glm::vec4(glm::vec3(color.value) * glm::vec3(light), 1.f);
+
+        // Any occluder will do, so stop at the first
         ray = { hit.point, lightDir, Inf };
         hit = {};
         for (auto& primitive : primitives) {
             rays++;
-            std::visit([&](auto&& prim) { return prim.Hit(ray, hit); }, primitive);
+            if (std::visit([&](auto&& prim) { return prim.Hit(ray, hit); }, primitive)) // Occluded from light
+                return glm::vec4(0.f, 0.f, 0.f, 1.f);
         }
 
-        if (ray.t < Inf) // Occluded from light
+        return glm::vec4(glm::vec3(color.value) * glm::vec3(light), 1.f);
+    }
+
+    glm::vec2 PixelNDC(int x, int y, float jitter)
+    {
+        // Compute normalized pixel position in [-1, 1] with some jitter
+        return {
+            (x + 0.5f + jitter * 0.5f * rng.Rand11()) * 2.f / textureSize.x - 1.f,
+            (y + 0.5f + jitter * 0.5f * rng.Rand11()) * 2.f / textureSize.y - 1.f
+        };
+    }
+
+    //// Kernels ////
+
+    // Generic per-pixel trace, all features are checked at runtime
+    glm::vec4 TraceGeneric(const KernelConstants&, int x, int y, float jitter)
+    {
+        return CastRay(PixelNDC(x, y, jitter));
+    }
+
+    KernelConstants MakeKernelConstants()
+    {
+        float aspect = float(textureSize.x) / float(textureSize.y);
+        float fov = glm::radians(fovDegrees);
+
+        return {
+            .pos { 0.f, 0.f, 1.f },
+            .X { aspect, 0.f, 0.f },
+            .Y { 0.f, 1.f, 0.f },
+            .Z { 0.f, 0.f, -1.f / glm::atan(fov * 0.5f) },
+            .lightDir = glm::normalize(glm::vec3(-2.f, 1.f, 1.f)),
+        };
+    }
+
+    template<bool SpheresOnly>
+    static bool HitPrimitive(Primitive& primitive, Ray& ray, Hit& hit)
+    {
+        if constexpr (SpheresOnly) {
+            return std::get_if<Sphere>(&primitive)->Hit(ray, hit);
+        } else {
+            return std::visit([&](auto&& prim) { return prim.Hit(ray, hit); }, primitive);
+        }
+    }
+
+    bool SpheresOnly()
+    {
+        return std::all_of(primitives.begin(), primitives.end(),
+            [](auto& primitive) { return std::holds_alternative<Sphere>(primitive); });
+    }
+
+    // Same result as CastRay, with the camera hoisted out and disabled features compiled away
+    template<bool Shadows, bool SpheresOnly>
+    glm::vec4 CastRayKernel(const KernelConstants& k, glm::vec2 ndc)
+    {
+        auto dir = glm::normalize(k.X * ndc.x + k.Y * ndc.y + k.Z);
+
+        Ray ray{k.pos, dir, Inf};
+        Hit hit{};
+        Color color {};
+
+        size_t count = primitives.size();
+        rays += count;
+        for (size_t i = 0; i < count; ++i) {
+            if (HitPrimitive<SpheresOnly>(primitives[i], ray, hit))
+                color = colours[i];
+        }
+
+        if (ray.t == Inf)
             return glm::vec4(0.f, 0.f, 0.f, 1.f);
 
+        float light = glm::dot(hit.normal, k.lightDir);
+
+        if constexpr (Shadows) {
+            ray = { hit.point, k.lightDir, Inf };
+            for (size_t i = 0; i < count; ++i) {
+                rays++;
+                if (HitPrimitive<SpheresOnly>(primitives[i], ray, hit))
+                    return glm::vec4(0.f, 0.f, 0.f, 1.f);
+            }
+        }
+
         return glm::vec4(glm::vec3(color.value) * glm::vec3(light), 1.f);
     }
 
-    void Sample(float weight, float jitter = 0.f)
+    // Specialized per-pixel trace
+    template<bool Jitter, bool Shadows, bool SpheresOnly>
+    glm::vec4 TraceKernel(const KernelConstants& k, int x, int y, float jitter)
     {
-        rng.UpdateRandomKernel();
+        glm::vec2 ndc;
+        if constexpr (Jitter) {
+            ndc = PixelNDC(x, y, jitter);
+        } else {
+            ndc = { (x + 0.5f) * 2.f / textureSize.x - 1.f, (y + 0.5f) * 2.f / textureSize.y - 1.f };
+        }
+
+        return CastRayKernel<Shadows, SpheresOnly>(k, ndc);
+    }
+
+    using TraceFn = glm::vec4 (App::*)(const KernelConstants&, int, int, float);
+
+    template<TraceFn Trace>
+    void SamplePass(const glm::vec4* src, glm::vec4* dst, float weight, float jitter)
+    {
+        auto k = MakeKernelConstants();
 
         for (int y = 0; y < textureSize.y; ++y) {
             for (int x = 0; x < textureSize.x; ++x) {
-                // Compute normalized pixel position in [-1, 1] with some jitter
-                glm::vec2 ndc = {
-                    (x + 0.5f + jitter * 0.5f * rng.Rand11()) * 2.f / textureSize.x - 1.f,
-                    (y + 0.5f + jitter * 0.5f * rng.Rand11()) * 2.f / textureSize.y - 1.f
-                };
-
                 // Compute update pixel value based on weight
-                Pixel(x, y) = Pixel(x, y) * (1.f - weight) + weight * CastRay(ndc);
+                size_t i = y * textureSize.x + x;
+                dst[i] = src[i] * (1.f - weight) + weight * (this->*Trace)(k, x, y, jitter);
             }
         }
     }
 
+    // Trace one ray per size x size block at its top-left pixel and fill the block with the result.
+    // Blocks already traced by the previous, twice as coarse, level are skipped, so refining
+    // down to a size of 1 leaves exactly one sample per pixel for the cost of a single pass
+    template<TraceFn Trace>
+    void PreviewPass(glm::vec4* dst, int size, float jitter)
+    {
+        auto k = MakeKernelConstants();
+
+        for (int y = 0; y < textureSize.y; y += size) {
+            for (int x = 0; x < textureSize.x; x += size) {
+                if (size < previewFirstBlock && x % (2 * size) == 0 && y % (2 * size) == 0)
+                    continue;
+
+                auto color = (this->*Trace)(k, x, y, jitter);
+
+                int maxX = glm::min(x + size, textureSize.x);
+                int maxY = glm::min(y + size, textureSize.y);
+                for (int by = y; by < maxY; ++by) {
+                    for (int bx = x; bx < maxX; ++bx)
+                        Pixel(dst, bx, by) = color;
+                }
+            }
+        }
+    }
+
+    struct Kernel {
+        void (App::*sample)(const glm::vec4*, glm::vec4*, float, float);
+        void (App::*preview)(glm::vec4*, int, float);
+    };
+
+    template<TraceFn Trace>
+    static constexpr Kernel MakeKernel()
+    {
+        return { &App::SamplePass<Trace>, &App::PreviewPass<Trace> };
+    }
+
+    Kernel SelectSpecializedKernel(float jitter)
+    {
+        // [jitter][shadows][spheres only]
+        static constexpr Kernel kernels[2][2][2] = {
+            {
+                { MakeKernel<&App::TraceKernel<false, false, false>>(), MakeKernel<&App::TraceKernel<false, false, true>>() },
+                { MakeKernel<&App::TraceKernel<false, true,  false>>(), MakeKernel<&App::TraceKernel<false, true,  true>>() },
+            },
+            {
+                { MakeKernel<&App::TraceKernel<true,  false, false>>(), MakeKernel<&App::TraceKernel<true,  false, true>>() },
+                { MakeKernel<&App::TraceKernel<true,  true,  false>>(), MakeKernel<&App::TraceKernel<true,  true,  true>>() },
+            },
+        };
+
+        return kernels[jitter != 0.f][shadows][SpheresOnly()];
+    }
+
+    // Kernel for this frame's sample or preview pass
+    Kernel SelectKernel(float jitter)
+    {
+        return specializedKernels ? SelectSpecializedKernel(jitter) : MakeKernel<&App::TraceGeneric>();
+    }
+
+    //// End of Kernels ////
+
+    void Sample(float weight, float jitter = 0.f)
+    {
+        rng.UpdateRandomKernel();
+
+        (this->*SelectKernel(jitter).sample)(front, back, weight, jitter);
+
+        CommitPass();
+    }
+
+    // Time passes of the generic and selected specialized kernel into a scratch buffer,
+    // leaving the accumulation and random state untouched
+    void BenchmarkKernels(int passes)
+    {
+        using namespace std::chrono;
+
+        std::vector<glm::vec4> scratch(pixels.size());
+        RNG savedRng = rng;
+        uint64_t savedRays = rays;
+
+        auto generic = MakeKernel<&App::TraceGeneric>().sample;
+        auto specialized = SelectSpecializedKernel(jitterAmount).sample;
+
+        auto timePass = [&](auto kernel) {
+            rng.UpdateRandomKernel();
+            auto start = high_resolution_clock::now();
+            (this->*kernel)(front, scratch.data(), 0.5f, jitterAmount);
+            return duration_cast<duration<float, std::milli>>(high_resolution_clock::now() - start).count();
+        };
+
+        // Untimed warm-up of both, then alternate which kernel goes first so
+        // neither consistently benefits from warm caches or clock ramp-up
+        timePass(generic);
+        timePass(specialized);
+
+        float genericTotal = 0.f, specializedTotal = 0.f;
+        for (int i = 0; i < passes; ++i) {
+            if (i % 2 == 0) {
+                genericTotal += timePass(generic);
+                specializedTotal += timePass(specialized);
+            } else {
+                specializedTotal += timePass(specialized);
+                genericTotal += timePass(generic);
+            }
+        }
+        genericPassTime = genericTotal / passes;
+        specializedPassTime = specializedTotal / passes;
+        benchmarkSize = textureSize;
+
+        rng = savedRng;
+        rays = savedRays;
+    }
+
+    // Progressive preview level, see PreviewPass
+    void Preview(int size, float jitter = 0.f)
+    {
+        rng.UpdateRandomKernel();
+
+        (this->*SelectKernel(jitter).preview)(front, size, jitter);
+
+        // Finest level complete, this counts as the first sample
+        if (size == 1) {
+            sample = 1;
+            WritePassState();
+        }
+    }
+
     void ResetSamples()
     {
         sample = 0;
         rays = 0;
+        sessionRaysStart = 0;
+        runs = { seed };
+
+        previewFirstBlock = previewBlock = 1 << previewLevels;
+        sampleStart = changeTime = std::chrono::high_resolution_clock::now();
+        awaitingFirstImage = true;
+
+        // The accumulation no longer matches the checkpoint, so leave the file as it is
+        if (!checkpointPath.empty()) {
+            DetachCheckpoint();
+            checkpointStatus = "Settings changed, detached " + checkpointPath;
+            checkpointPath.clear();
+        }
+    }
+
+    //// Checkpoints ////
+
+    static uint64_t HashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        // FNV-1a
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    uint64_t SceneHash()
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (auto& primitive : primitives) {
+            size_t index = primitive.index();
+            hash = HashBytes(hash, &index, sizeof(index));
+            std::visit([&](auto&& prim) { hash = HashBytes(hash, &prim, sizeof(prim)); }, primitive);
+        }
+        return HashBytes(hash, colours.data(), colours.size() * sizeof(Color));
+    }
+
+    bool IsValidCheckpoint(const MappedFile& file)
+    {
+        if (file.size < sizeof(CheckpointHeader))
+            return false;
+
+        auto& header = *static_cast<const CheckpointHeader*>(file.data);
+        return header.magic == CheckpointHeader::Magic
+            && header.version == CheckpointHeader::Version
+            && header.sceneHash == SceneHash()
+            && header.textureSize.x > 0 && header.textureSize.y > 0
+            && header.current < 2
+            && header.passes[header.current].runCount <= CheckpointPass::MaxRuns
+            && file.size == CheckpointHeader::FileSize(header.textureSize);
+    }
+
+    CheckpointHeader& Checkpoint()
+    {
+        return *static_cast<CheckpointHeader*>(checkpoint.data);
+    }
+
+    // Publish the pass just written to the back buffer
+    void CommitPass()
+    {
+        std::swap(front, back);
+        WritePassState();
+    }
+
+    // Record the state of the front buffer in the checkpoint
+    void WritePassState()
+    {
+        if (!checkpoint.data)
+            return;
+
+        // Write the new pass state first, then flip to it with a single store.
+        // Previews update the current buffer in place, so the sample count is written last.
+        // The fences keep the compiler from reordering the stores that publish the pass
+        auto& header = Checkpoint();
+        uint32_t next = front == header.Buffer(0) ? 0 : 1;
+        auto& pass = header.passes[next];
+        WritePassRuns(pass);
+        pass.rays = rays;
+        std::memcpy(pass.rng, &rng.rng, sizeof(pass.rng));
+        std::atomic_signal_fence(std::memory_order_release);
+        pass.sample = sample;
+        std::atomic_signal_fence(std::memory_order_release);
+        header.current = next;
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastFlush > std::chrono::seconds(5)) {
+            checkpoint.Flush();
+            lastFlush = now;
+        }
+    }
+
+    void WritePassRuns(CheckpointPass& pass)
+    {
+        pass.runCount = uint32_t(runs.size());
+        std::copy(runs.begin(), runs.end(), pass.runs);
+    }
+
+    // Copy the accumulation back into memory and release the mapping
+    void DetachCheckpoint()
+    {
+        if (!checkpoint.data)
+            return;
+
+        pixels.assign(front, front + pixels.size());
+        front = back = pixels.data();
+        checkpoint.Flush();
+        checkpoint.Close();
+    }
+
+    // Create a new checkpoint file seeded with the current accumulation state
+    bool CreateCheckpoint(const std::string& path)
+    {
+        DetachCheckpoint();
+        if (!checkpoint.Create(path.c_str(), CheckpointHeader::FileSize(textureSize)))
+            return false;
+
+        auto& header = Checkpoint();
+        header.version = CheckpointHeader::Version;
+        header.sceneHash = SceneHash();
+        header.seed = seed;
+        header.textureSize = textureSize;
+        header.fovDegrees = fovDegrees;
+        header.texSizeMultiplier = texSizeMultiplier;
+        header.jitter = jitterAmount;
+        header.shadows = shadows;
+        header.current = 0;
+        std::memcpy(header.Buffer(0), pixels.data(), pixels.size() * sizeof(glm::vec4));
+
+        auto& pass = header.passes[0];
+        pass.sample = sample;
+        pass.rays = rays;
+        std::memcpy(pass.rng, &rng.rng, sizeof(pass.rng));
+        WritePassRuns(pass);
+
+        // Only mark the file as a checkpoint once everything else is in place
+        std::atomic_signal_fence(std::memory_order_release);
+        header.magic = CheckpointHeader::Magic;
+
+        front = header.Buffer(0);
+        back = header.Buffer(1);
+
+        checkpoint.Flush();
+        lastFlush = std::chrono::steady_clock::now();
+        return true;
+    }
+
+    // Attach a checkpoint file, resuming from it if it exists or creating it otherwise.
+    // Existing files are never overwritten
+    void OpenCheckpoint(const std::string& path)
+    {
+        DetachCheckpoint();
+        checkpointPath.clear();
+
+        if (!checkpoint.Open(path.c_str(), true)) {
+            if (checkpoint.inUse) {
+                checkpointStatus = "Checkpoint in use by another process: " + path;
+            } else if (CreateCheckpoint(path)) {
+                checkpointPath = path;
+                checkpointStatus = "Created " + path;
+            } else {
+                checkpointStatus = "Failed to open " + path;
+            }
+            return;
+        }
+
+        if (!IsValidCheckpoint(checkpoint)) {
+            checkpoint.Close();
+            checkpointStatus = "Incompatible checkpoint: " + path;
+            return;
+        }
+
+        // Resume from the last completed pass
+        checkpointPath = path;
+        auto& header = Checkpoint();
+        textureSize = header.textureSize;
+        fovDegrees = header.fovDegrees;
+        texSizeMultiplier = header.texSizeMultiplier;
+        jitterAmount = header.jitter;
+        shadows = header.shadows;
+        seed = header.seed;
+        pixels.resize(textureSize.x * textureSize.y);
+
+        auto& pass = header.passes[header.current];
+        sample = pass.sample;
+        rays = sessionRaysStart = pass.rays;
+        std::memcpy(&rng.rng, pass.rng, sizeof(pass.rng));
+        runs.assign(pass.runs, pass.runs + pass.runCount);
+
+        // Restart the preview refinement, earlier levels were traced by another run
+        if (sample == 0)
+            previewFirstBlock = previewBlock = 1 << previewLevels;
+
+        front = header.Buffer(header.current);
+        back = header.Buffer(1 - header.current);
+
+        sampleStart = sampleEnd = std::chrono::high_resolution_clock::now();
+        lastFlush = std::chrono::steady_clock::now();
+        checkpointStatus = "Resumed " + path + " at sample " + std::to_string(sample);
+    }
+
+    // Fold the samples from another run of the same scene and camera into the current accumulation
+    void MergeCheckpoint(const std::string& path)
+    {
+        MappedFile other;
+        if (!other.Open(path.c_str(), false) || !IsValidCheckpoint(other)) {
+            checkpointStatus = "Not a compatible checkpoint: " + path;
+            return;
+        }
+
+        auto& header = *static_cast<CheckpointHeader*>(other.data); // Read-only mapping
+        if (header.textureSize != textureSize || header.fovDegrees != fovDegrees
+                || header.jitter != jitterAmount || bool(header.shadows) != shadows) {
+            checkpointStatus = "Camera, resolution or render settings differ: " + path;
+            return;
+        }
+
+        auto& pass = header.passes[header.current];
+        if (pass.sample <= 0) {
+            checkpointStatus = "No samples in " + path;
+            return;
+        }
+
+        // Each run's samples may only be counted once
+        for (uint32_t i = 0; i < pass.runCount; ++i) {
+            if (std::find(runs.begin(), runs.end(), pass.runs[i]) != runs.end()) {
+                checkpointStatus = "Samples already included: " + path;
+                return;
+            }
+        }
+        if (runs.size() + pass.runCount > CheckpointPass::MaxRuns) {
+            checkpointStatus = "Too many merged runs: " + path;
+            return;
+        }
+
+        // Weighted average by sample count, written as a regular pass
+        const glm::vec4* src = header.Buffer(header.current);
+        float weight = float(pass.sample) / float(sample + pass.sample);
+        for (size_t i = 0; i < pixels.size(); ++i)
+            back[i] = front[i] * (1.f - weight) + weight * src[i];
+
+        sample += pass.sample;
+        rays += pass.rays;
+        sessionRaysStart += pass.rays;
+        runs.insert(runs.end(), pass.runs, pass.runs + pass.runCount);
+        CommitPass();
+
+        checkpointStatus = "Merged " + std::to_string(pass.sample) + " samples from " + path;
     }
 
     std::string formatLargeNumber(uint64_t value)
@@ -338,9 +1060,12 @@ struct App {
 
             // Show Statistics
             ImGui::Text("Sample: %i", sample);
-            ImGui::Text("Rays/s: %s", formatLargeNumber(rays / duration_cast<duration<float>>(sampleEnd - sampleStart).count()).c_str());
+            // Rate is for this session only, totals include resumed and merged checkpoints
+            float seconds = duration_cast<duration<float>>(sampleEnd - sampleStart).count();
+            uint64_t raysPerSecond = seconds > 0.f ? uint64_t((rays - sessionRaysStart) / seconds) : 0;
+            ImGui::Text("Rays/s: %s", formatLargeNumber(raysPerSecond).c_str());
             ImGui::Text("Total Rays: %s", formatLargeNumber(rays).c_str());
-            ImGui::Text("Time: %.1fs", duration_cast<duration<float>>(sampleEnd - sampleStart).count());
+            ImGui::Text("Time: %.1fs", seconds);
             ImGui::Text("Texture Size: (%i, %i)", textureSize.x, textureSize.y);
             ImGui::Text("FPS: %i", fps);
 
@@ -353,13 +1078,54 @@ struct App {
                 ResetSamples();
             }
 
+            if (ImGui::SliderFloat("Jitter", &jitterAmount, 0.f, 1.f)) {
+                ResetSamples();
+            }
+
+            if (ImGui::Checkbox("Shadows", &shadows)) {
+                ResetSamples();
+            }
+
+            ImGui::Checkbox("Specialized kernels", &specializedKernels);
+            if (ImGui::Button("Benchmark kernels")) {
+                BenchmarkKernels(10);
+            }
+            ImGui::Text("Generic: %.2fms/pass, Specialized: %.2fms/pass (%ix%i)",
+                genericPassTime, specializedPassTime, benchmarkSize.x, benchmarkSize.y);
+
+            const char* previewNames[] = { "Off", "1/2", "1/4", "1/8" };
+            ImGui::Combo("Preview", &previewLevels, previewNames, 4);
+            ImGui::Text("First image: %.1fms", firstImageLatency);
+
+            // Memory-mapped checkpoint of the accumulation state
+            ImGui::Separator();
+            ImGui::InputText("Checkpoint", checkpointInput, sizeof(checkpointInput));
+            if (ImGui::Button("Open")) {
+                OpenCheckpoint(checkpointInput);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Detach")) {
+                DetachCheckpoint();
+                checkpointPath.clear();
+                checkpointStatus.clear();
+            }
+            ImGui::InputText("Merge from", mergeInput, sizeof(mergeInput));
+            if (ImGui::Button("Merge")) {
+                MergeCheckpoint(mergeInput);
+            }
+            if (!checkpointStatus.empty())
+                ImGui::TextUnformatted(checkpointStatus.c_str());
+
             ImGui::End();
 
-            // Sample using exponential moving average and update times
-            if (sample == 0)
-                sampleStart = high_resolution_clock::now();
-            if (sample < 100) {
-                Sample(1.f / ++sample, 1.f);
+            // Refine the progressive preview until each pixel has a sample
+            // Otherwise sample using exponential moving average and update times
+            if (sample == 0 && previewBlock > 0) {
+                Preview(previewBlock, jitterAmount);
+                previewBlock /= 2;
+                sampleEnd = high_resolution_clock::now();
+            } else if (sample < 100) {
+                Sample(1.f / ++sample, jitterAmount);
                 sampleEnd = high_resolution_clock::now();
             }
 
@@ -378,6 +1144,11 @@ struct App {
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
             glfwSwapBuffers(window);
 
+            if (awaitingFirstImage) {
+                firstImageLatency = duration_cast<duration<float, std::milli>>(high_resolution_clock::now() - changeTime).count();
+                awaitingFirstImage = false;
+            }
+
             glfwPollEvents();
 
             frames++;
@@ -385,7 +1156,15 @@ struct App {
     }
 };
 
-int main()
+int main(int argc, char* argv[])
 {
-    App{}.Run();
+    App app;
+
+    // Optional checkpoint file to resume from, followed by checkpoints from other runs to merge in
+    if (argc > 1)
+        app.OpenCheckpoint(argv[1]);
+    for (int i = 2; i < argc; ++i)
+        app.MergeCheckpoint(argv[i]);
+
+    app.Run();
 }
\ No newline at end of file